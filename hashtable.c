@@ -1,19 +1,105 @@
+#ifdef __linux__
+#define _GNU_SOURCE // mmap flags, madvise, syscall and getrandom
+#endif
+
 #include "hashtable.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/syscall.h>
+#endif
 
 
 /*
  * value
  */
 
+#ifdef HASHTABLE_COMPACT_VALUE
+
+#define VALUE_TAGGED    0xFFF8000000000000u // negative quiet NaN, never produced by value_set_real
+#define VALUE_STORED_XOR VALUE_TAGGED       // stored bits are the encoding xor this, so all-zero bits are nil
+#define VALUE_CANONICAL_NAN 0x7FF8000000000000u
+#define VALUE_TAG_SHIFT 48
+#define VALUE_PAYLOAD   0x0000FFFFFFFFFFFFu
+#define VALUE_INLINE_SIGN ((uint64_t)1 << 47)
+
+enum value_tag {
+  VALUE_TAG_NIL,
+  VALUE_TAG_BOOLEAN,
+  VALUE_TAG_INTEGER,  // 48-bit integer stored inline
+  VALUE_TAG_CUSTOM,
+  VALUE_TAG_BOXED,    // pointer to a heap-allocated int64_t owned by the value
+};
+
+static uint64_t value_bits(const struct value *self) {
+  return self->bits ^ VALUE_STORED_XOR;
+}
+
+static void value_set_bits(struct value *self, uint64_t bits) {
+  self->bits = bits ^ VALUE_STORED_XOR;
+}
+
+static bool value_tagged(const struct value *self) {
+  return (value_bits(self) & VALUE_TAGGED) == VALUE_TAGGED;
+}
+
+static enum value_tag value_tag(const struct value *self) {
+  return (enum value_tag)((value_bits(self) >> VALUE_TAG_SHIFT) & 0x7);
+}
+
+static void value_set_tagged(struct value *self, enum value_tag tag, uint64_t payload) {
+  value_set_bits(self, VALUE_TAGGED | ((uint64_t)tag << VALUE_TAG_SHIFT) | payload);
+}
+
+// un pointeur tronqué serait plus tard déréférencé ou libéré: on refuse bruyamment, même avec NDEBUG
+static void value_set_pointer(struct value *self, enum value_tag tag, const void *ptr) {
+  if (((uintptr_t)ptr & ~(uintptr_t)VALUE_PAYLOAD) != 0) {
+    fprintf(stderr, "hashtable: pointer %p does not fit in a compact value\n", ptr);
+    abort();
+  }
+  value_set_tagged(self, tag, (uintptr_t)ptr);
+}
+
+static void *value_pointer(const struct value *self) {
+  return (void *)(uintptr_t)(value_bits(self) & VALUE_PAYLOAD);
+}
+
+enum value_kind value_get_kind(const struct value *self) {
+  if (!value_tagged(self)) {
+    return VALUE_REAL;
+  }
+  switch (value_tag(self)) {
+    case VALUE_TAG_NIL:
+      return VALUE_NIL;
+    case VALUE_TAG_BOOLEAN:
+      return VALUE_BOOLEAN;
+    case VALUE_TAG_INTEGER:
+    case VALUE_TAG_BOXED:
+      return VALUE_INTEGER;
+    default:
+      return VALUE_CUSTOM;
+  }
+}
+
+#else
+
 enum value_kind value_get_kind(const struct value *self) {
   return self->kind;
 }
 
+#endif
+
 bool value_is_nil(const struct value *self) {
   return value_get_kind(self) == VALUE_NIL;
 }
@@ -35,6 +121,69 @@ bool value_is_custom(const struct value *self) {
 }
 
 
+#ifdef HASHTABLE_COMPACT_VALUE
+
+void value_set_nil(struct value *self) {
+  value_set_tagged(self, VALUE_TAG_NIL, 0);
+}
+
+void value_set_boolean(struct value *self, bool val) {
+  value_set_tagged(self, VALUE_TAG_BOOLEAN, val);
+}
+
+void value_set_integer(struct value *self, int64_t val) {
+  if (val >= -(int64_t)VALUE_INLINE_SIGN && val < (int64_t)VALUE_INLINE_SIGN) {
+    value_set_tagged(self, VALUE_TAG_INTEGER, (uint64_t)val & VALUE_PAYLOAD);
+    return;
+  }
+  int64_t *box = malloc(sizeof(int64_t));
+  *box = val;
+  value_set_pointer(self, VALUE_TAG_BOXED, box);
+}
+
+void value_set_real(struct value *self, double val) {
+  if (val != val) {
+    value_set_bits(self, VALUE_CANONICAL_NAN);
+    return;
+  }
+  uint64_t bits;
+  memcpy(&bits, &val, sizeof(double));
+  value_set_bits(self, bits);
+}
+
+void value_set_custom(struct value *self, void *val) {
+  value_set_pointer(self, VALUE_TAG_CUSTOM, val);
+}
+
+
+bool value_get_boolean(const struct value *self) {
+  assert(value_get_kind(self) == VALUE_BOOLEAN);
+  return (value_bits(self) & VALUE_PAYLOAD) != 0;
+}
+
+int64_t value_get_integer(const struct value *self) {
+  assert(value_get_kind(self) == VALUE_INTEGER);
+  if (value_tag(self) == VALUE_TAG_BOXED) {
+    return *(const int64_t *)value_pointer(self);
+  }
+  return (int64_t)((value_bits(self) & VALUE_PAYLOAD) ^ VALUE_INLINE_SIGN) - (int64_t)VALUE_INLINE_SIGN;
+}
+
+double value_get_real(const struct value *self) {
+  assert(value_get_kind(self) == VALUE_REAL);
+  uint64_t bits = value_bits(self);
+  double res;
+  memcpy(&res, &bits, sizeof(double));
+  return res;
+}
+
+void *value_get_custom(const struct value *self) {
+  assert(value_get_kind(self) == VALUE_CUSTOM);
+  return value_pointer(self);
+}
+
+#else
+
 void value_set_nil(struct value *self) {
   self->kind = VALUE_NIL;
   self->as.custom = NULL;
@@ -81,6 +230,8 @@ void *value_get_custom(const struct value *self) {
   return self->as.custom;
 }
 
+#endif
+
 
 struct value value_make_nil() {
   struct value res;
@@ -113,11 +264,292 @@ struct value value_make_custom(void *val) {
 }
 
 
+void value_release(struct value *self) {
+#ifdef HASHTABLE_COMPACT_VALUE
+  if (value_tagged(self) && value_tag(self) == VALUE_TAG_BOXED) {
+    free(value_pointer(self));
+  }
+#endif
+  value_set_nil(self);
+}
+
+struct value value_copy(const struct value *self) {
+#ifdef HASHTABLE_COMPACT_VALUE
+  if (value_tagged(self) && value_tag(self) == VALUE_TAG_BOXED) {
+    return value_make_integer(value_get_integer(self));
+  }
+#endif
+  return *self;
+}
+
+// libère old sauf s'il partage son stockage avec kept, la valeur conservée
+static void value_release_unless(struct value *old, const struct value *kept) {
+#ifdef HASHTABLE_COMPACT_VALUE
+  if (old->bits == kept->bits) {
+    return;
+  }
+#else
+  (void)kept;
+#endif
+  value_release(old);
+}
+
+
+
+/*
+ * bucket arrays
+ */
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+static bool buckets_mapped(size_t bytes, unsigned policy){
+#ifdef __linux__
+  return policy != HASHTABLE_ALLOC_DEFAULT && bytes >= HASHTABLE_LARGE_ALLOC;
+#else
+  (void)bytes;
+  (void)policy;
+  return false;
+#endif
+}
+
+static size_t buckets_mapped_length(size_t bytes){
+  return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+// alloue un tableau de buckets initialisé à zéro selon la politique d'allocation
+static void *buckets_alloc(size_t count, size_t elem, unsigned policy){
+  size_t bytes = count * elem;
+  if(!buckets_mapped(bytes, policy)){
+    if(elem % HASHTABLE_CACHE_LINE != 0){
+      return calloc(count, elem);
+    }
+    void *ptr = aligned_alloc(HASHTABLE_CACHE_LINE, bytes);  //calloc ne garantit que 16 octets
+    if(ptr != NULL){
+      memset(ptr, 0, bytes);
+    }
+    return ptr;
+  }
+#ifdef __linux__
+  size_t length = buckets_mapped_length(bytes);
+  char *addr = MAP_FAILED;
+
+  if(policy & HASHTABLE_ALLOC_HUGEPAGES){      //on essaie d'abord les pages de 2 Mo réservées (hugetlbfs)
+    addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+
+  if(addr == MAP_FAILED){                      //sinon on aligne la zone sur 2 Mo pour les transparent huge pages
+    char *raw = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+      return NULL;
+    }
+    addr = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if(addr != raw){
+      munmap(raw, (size_t)(addr - raw));
+    }
+    munmap(addr + length, (size_t)(raw + HUGE_PAGE_SIZE - addr));
+    if(policy & HASHTABLE_ALLOC_HUGEPAGES){
+      madvise(addr, length, MADV_HUGEPAGE);
+    }
+  }
+
+  if(policy & HASHTABLE_ALLOC_INTERLEAVE){     //répartit les pages sur tous les noeuds autorisés, échec non fatal
+    unsigned long nodemask = ~0ul;
+    syscall(SYS_mbind, addr, length, MPOL_INTERLEAVE, &nodemask, sizeof(nodemask) * 8, 0);
+  }
+
+  return addr;
+#else
+  return calloc(count, elem);
+#endif
+}
+
+static void buckets_free(void *ptr, size_t count, size_t elem, unsigned policy){
+  size_t bytes = count * elem;
+  if(!buckets_mapped(bytes, policy)){
+    free(ptr);
+    return;
+  }
+#ifdef __linux__
+  munmap(ptr, buckets_mapped_length(bytes));
+#endif
+}
+
+
+
+/*
+ * copy-on-write pages
+ */
+
+struct bucket_slab {
+  atomic_size_t refs; // pages of the slab still in use
+  char *memory;
+  size_t count;       // number of pages
+  size_t bytes;       // size of a page in bytes
+  unsigned policy;
+};
+
+struct bucket_page {
+  atomic_size_t refs;       // tables and snapshots sharing the page
+  struct bucket_slab *slab; // NULL for a page allocated alone by a copy
+  struct bucket *heads[];
+};
+
+// les clés des noeuds chaînés sont immuables: une copie de page les partage au lieu de les dupliquer
+struct bucket_key {
+  atomic_size_t refs; // nodes pointing to the key, in the table and its snapshots
+  char str[];
+};
+
+static struct bucket_key *key_header(const char *key){
+  return (struct bucket_key *)(key - offsetof(struct bucket_key, str));
+}
+
+static char *key_create(const char *key){
+  size_t length = strlen(key) + 1;
+  struct bucket_key *res = malloc(sizeof(struct bucket_key) + length);
+  atomic_init(&res->refs, 1);
+  memcpy(res->str, key, length);
+  return res->str;
+}
+
+static char *key_share(char *key){
+  atomic_fetch_add_explicit(&key_header(key)->refs, 1, memory_order_relaxed);
+  return key;
+}
+
+static void key_release(char *key){
+  struct bucket_key *header = key_header(key);
+  if(atomic_fetch_sub(&header->refs, 1) == 1){
+    free(header);
+  }
+}
+
+static size_t page_bytes(size_t page_size){
+  return sizeof(struct bucket_page) + page_size * sizeof(struct bucket *);
+}
+
+// alloue d'un seul bloc les pages d'un tableau de size buckets
+static struct bucket_page **pages_create(size_t size, unsigned policy, size_t *shift){
+  assert((size & (size - 1)) == 0);
+  *shift = 0;
+  while(((size_t)1 << *shift) < size && *shift < HASHTABLE_PAGE_SHIFT){
+    ++*shift;
+  }
+
+  struct bucket_slab *slab = malloc(sizeof(struct bucket_slab));
+  slab->count = size >> *shift;
+  slab->bytes = page_bytes((size_t)1 << *shift);
+  slab->policy = policy;
+  slab->memory = buckets_alloc(slab->count, slab->bytes, policy);
+  atomic_init(&slab->refs, slab->count);
+
+  struct bucket_page **pages = malloc(slab->count * sizeof(struct bucket_page *));
+  for(size_t i = 0; i < slab->count; ++i){
+    pages[i] = (struct bucket_page *)(slab->memory + i * slab->bytes);
+    atomic_init(&pages[i]->refs, 1);
+    pages[i]->slab = slab;
+  }
+  return pages;
+}
+
+// libère une référence sur la page, et la page elle-même (avec ses noeuds si free_nodes) à la dernière
+static void page_release(struct bucket_page *page, size_t page_size, bool free_nodes){
+  if(atomic_fetch_sub(&page->refs, 1) != 1){
+    return;
+  }
+  for(size_t i = 0; i < page_size && free_nodes; ++i){
+    struct bucket *current = page->heads[i];
+    while(current != NULL){
+      struct bucket *next = current->next;
+      value_release(&current->value);
+      key_release(current->key);
+      free(current);
+      current = next;
+    }
+  }
+
+  struct bucket_slab *slab = page->slab;
+  if(slab == NULL){
+    free(page);
+  }else if(atomic_fetch_sub(&slab->refs, 1) == 1){
+    buckets_free(slab->memory, slab->count, slab->bytes, slab->policy);
+    free(slab);
+  }
+}
+
+static void pages_release(struct bucket_page **pages, size_t count, size_t page_size){
+  for(size_t i = 0; i < count; ++i){
+    page_release(pages[i], page_size, true);
+  }
+  free(pages);
+}
+
+static struct bucket_page *page_copy(const struct bucket_page *page, size_t page_size){
+  struct bucket_page *res = malloc(page_bytes(page_size));
+  atomic_init(&res->refs, 1);
+  res->slab = NULL;
+  for(size_t i = 0; i < page_size; ++i){
+    struct bucket **link = &res->heads[i];    //on recopie chaque liste dans le même ordre, seules les clés sont partagées
+    for(const struct bucket *current = page->heads[i]; current != NULL; current = current->next){
+      struct bucket *node = malloc(sizeof(struct bucket));
+      node->key = key_share(current->key);
+      node->value = value_copy(&current->value);
+      *link = node;
+      link = &node->next;
+    }
+    *link = NULL;
+  }
+  return res;
+}
+
+
 
 /*
  * hashtable
  */
 
+static void cuckoo_create(struct hashtable *self);
+static void cuckoo_destroy(struct hashtable *self);
+static bool cuckoo_insert(struct hashtable *self, const char *key, struct value val);
+static bool cuckoo_remove(struct hashtable *self, const char *key);
+static struct value *cuckoo_lookup(const struct hashtable *self, const char *key);
+static void cuckoo_rehash(struct hashtable *self);
+static bool cuckoo_reseed(struct hashtable *self);
+
+static size_t chained_page_size(const struct hashtable *self){
+  return (size_t)1 << self->page_shift;
+}
+
+static size_t chained_page_count(const struct hashtable *self){
+  return self->size >> self->page_shift;
+}
+
+static struct bucket **chained_head(const struct hashtable *self, size_t index){
+  return &self->pages[index >> self->page_shift]->heads[index & (chained_page_size(self) - 1)];
+}
+
+static bool chained_shared(const struct hashtable *self, size_t index){
+  return atomic_load_explicit(&self->pages[index >> self->page_shift]->refs, memory_order_acquire) != 1;
+}
+
+// copie la page si un instantané la partage encore, avant toute modification
+static struct bucket **chained_head_mut(struct hashtable *self, size_t index){
+  size_t page = index >> self->page_shift;
+  if(chained_shared(self, index)){
+    struct bucket_page *shared = self->pages[page];
+    self->pages[page] = page_copy(shared, chained_page_size(self));
+    page_release(shared, chained_page_size(self), true);
+  }
+  return chained_head(self, index);
+}
+
+static void chained_resize(struct hashtable *self, size_t new_size);
+
+static void chained_unshare(struct hashtable *self){
+  for(size_t i = 0; i < chained_page_count(self); ++i){
+    chained_head_mut(self, i << self->page_shift);
+  }
+}
 
 size_t str_length(const char *str)
 {
@@ -134,9 +566,28 @@ size_t str_length(const char *str)
 }
 
 void hashtable_create(struct hashtable *self){
+  hashtable_create_with_policy(self, HASHTABLE_ALLOC_DEFAULT);
+}
+
+void hashtable_create_with_policy(struct hashtable *self, unsigned policy){
+  hashtable_create_with_engine(self, HASHTABLE_ENGINE_CHAINED, policy);
+}
+
+void hashtable_create_with_engine(struct hashtable *self, enum hashtable_engine engine, unsigned policy){
   self->size = HASHTABLE_INITIAL_SIZE;
   self->count = 0;
-  self->buckets = calloc(self->size, sizeof(struct bucket));
+  self->policy = policy;
+  self->seed = 0;
+  self->engine = engine;
+  self->pages = NULL;
+  self->page_shift = 0;
+  self->slots = NULL;
+  self->stash_count = 0;
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    cuckoo_create(self);
+    return;
+  }
+  self->pages = pages_create(self->size, self->policy, &self->page_shift);
 }
 
 bool bucket_empty(const struct bucket *self){
@@ -144,16 +595,11 @@ bool bucket_empty(const struct bucket *self){
 }
 
 void hashtable_destroy(struct hashtable *self){
-  for(size_t i = 0; i < self->size; ++i){
-    struct bucket *current = self->buckets[i];
-    while(current != NULL){
-      struct bucket *next = current->next;
-      free(current->key);
-      free(current);
-      current = next;
-    }
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    cuckoo_destroy(self);
+    return;
   }
-  free(self->buckets);
+  pages_release(self->pages, chained_page_count(self), chained_page_size(self)); //les pages encore partagées survivent à la table
 }
 
 size_t hashtable_get_count(const struct hashtable *self) {
@@ -171,32 +617,103 @@ size_t hash(const char *key){
     hash ^= key[i];
     hash *= prime;
   }
+  hash ^= hash >> 33;                           //mélange final: l'indice du bucket ne prend que les bits de poids faible,
+  hash *= 0xff51afd7ed558ccdu;                  //qui sans lui ne dépendent que des derniers caractères de la clé
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53u;
+  hash ^= hash >> 33;
   return hash;
 }
 
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+static void sip_round(uint64_t v[4]){
+  v[0] += v[1]; v[1] = ROTL(v[1], 13); v[1] ^= v[0]; v[0] = ROTL(v[0], 32);
+  v[2] += v[3]; v[3] = ROTL(v[3], 16); v[3] ^= v[2];
+  v[0] += v[3]; v[3] = ROTL(v[3], 21); v[3] ^= v[0];
+  v[2] += v[1]; v[1] = ROTL(v[1], 17); v[1] ^= v[2]; v[2] = ROTL(v[2], 32);
+}
+
+// SipHash-1-3: plus lent que hash() mais impossible à attaquer sans connaître la graine
+static uint64_t siphash13(const unsigned char *in, size_t length, uint64_t k0, uint64_t k1){
+  uint64_t v[4] = { k0 ^ 0x736f6d6570736575u, k1 ^ 0x646f72616e646f6du, k0 ^ 0x6c7967656e657261u, k1 ^ 0x7465646279746573u };
+
+  size_t i = 0;
+  for(; i + 8 <= length; i += 8){
+    uint64_t m = 0;
+    for(size_t j = 0; j < 8; ++j){
+      m |= (uint64_t)in[i + j] << (8 * j);
+    }
+    v[3] ^= m;
+    sip_round(v);
+    v[0] ^= m;
+  }
+
+  uint64_t last = (uint64_t)length << 56;
+  for(size_t j = 0; i + j < length; ++j){
+    last |= (uint64_t)in[i + j] << (8 * j);
+  }
+  v[3] ^= last;
+  sip_round(v);
+  v[0] ^= last;
+
+  v[2] ^= 0xff;
+  sip_round(v);
+  sip_round(v);
+  sip_round(v);
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+static size_t hash_seeded(const char *key, uint64_t seed){
+  if(seed == 0){
+    return hash(key);
+  }
+  return (size_t)siphash13((const unsigned char *)key, strlen(key), seed, seed ^ 0x9e3779b97f4a7c15u);
+}
+
+static uint64_t hash_new_seed(uint64_t previous){
+  uint64_t seed = 0;
+#ifdef __linux__
+  if(getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != (ssize_t)sizeof(seed))
+#endif
+  {
+    seed = previous * 6364136223846793005u + (uint64_t)time(NULL) + (uint64_t)clock() + (uintptr_t)&seed;
+  }
+  return seed != 0 ? seed : 1;
+}
+
 bool hashtable_insert(struct hashtable *self, const char *key, struct value val){
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    return cuckoo_insert(self, key, val);
+  }
 
-  size_t key_hash = hash(key);
+  size_t key_hash = hash_seeded(key, self->seed);
   size_t index = key_hash % self->size;
-  struct bucket *current = self->buckets[index];              //on récupère le bucket courant à l'indice de hachage et on va 
+  struct bucket **head = chained_head_mut(self, index);
+  struct bucket *current = *head;                             //on récupère le bucket courant à l'indice de hachage et on va 
+  size_t length = 0;
   while(current != NULL){                                     //parcourir la liste tant que le noeud courant n'est pas NULL
     if(strcmp(current->key, key) == 0){                       //si la clé est déjà présente on a juste a modifié la valeur correspond à la clé
+      value_release_unless(&current->value, &val);
       current->value = val;
       return false;
     }
     current = current->next; 
+    ++length;
   }
 
-  char *n_key = malloc((str_length(key) + 1) * sizeof(char)); //sinon on va initialisé le noeud avec la clé, la valeur est mettre le suivant à NULL
-  strcpy(n_key, key);
-
-  current = malloc(sizeof(struct bucket));
-  current->key = n_key;
+  current = malloc(sizeof(struct bucket));                    //sinon on va initialisé le noeud avec la clé, la valeur est mettre le suivant à NULL
+  current->key = key_create(key);
   current->value = val;
-  current->next = self->buckets[index];
-  self->buckets[index] = current;
+  current->next = *head;
+  *head = current;
   ++self->count;
 
+  if(length >= HASHTABLE_CHAIN_LIMIT){                         //liste anormalement longue: on change de graine et on redistribue
+    self->seed = hash_new_seed(self->seed);
+    chained_resize(self, self->size);
+  }
+
   if((double)(self->count) / self->size > 1.0 / 2){           //on va effectuer un rehash si la compression est supérieur à 0.5
     hashtable_rehash(self);
   }
@@ -205,18 +722,26 @@ bool hashtable_insert(struct hashtable *self, const char *key, struct value val)
 }
 
 bool hashtable_remove(struct hashtable *self, const char *key){
-  size_t key_hash = hash(key);
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    return cuckoo_remove(self, key);
+  }
+  size_t key_hash = hash_seeded(key, self->seed);
   size_t index = key_hash % self->size;
-  struct bucket *current = self->buckets[index];  //on récupère le bucket courant à l'indice de hachage et on va parcourir la liste
+  if(chained_shared(self, index) && !hashtable_contains(self, key)){ //inutile de copier la page si la clé est absente
+    return false;
+  }
+  struct bucket **head = chained_head_mut(self, index);
+  struct bucket *current = *head;                 //on récupère le bucket courant à l'indice de hachage et on va parcourir la liste
   struct bucket *prev = NULL;                     //tant que le noeud n'est pas NULL
   while(current != NULL){
     if(strcmp(current->key, key) == 0){           //si la clé est égal à la clé courante alors
       if(prev != NULL){                           //si prev est non NULL donc on est après le debut de la liste donc le suivant de prev est égal au suivant du courant
         prev->next = current->next;
       }else{                                      //sinon on est au debut de la liste est donc on met le suivant du debut de la liste au suivant du courant
-        self->buckets[index] = current->next;
+        *head = current->next;
       }
-      free(current->key);
+      value_release(&current->value);
+      key_release(current->key);
       free(current);
       --self->count;
       return true;
@@ -228,9 +753,12 @@ bool hashtable_remove(struct hashtable *self, const char *key){
 }
 
 bool hashtable_contains(const struct hashtable *self, const char *key){
-  size_t key_hash = hash(key);
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    return cuckoo_lookup(self, key) != NULL;
+  }
+  size_t key_hash = hash_seeded(key, self->seed);
   size_t index = key_hash % self->size;
-  struct bucket *current = self->buckets[index];  //on récupère le bucket courant à l'indice de hachage et on va parcourir la liste 
+  struct bucket *current = *chained_head(self, index); //on récupère le bucket courant à l'indice de hachage et on va parcourir la liste 
   while(current != NULL){
     if(strcmp(current->key, key) == 0){           //si la clé est présente on va retourner vrai
       return true;
@@ -241,29 +769,47 @@ bool hashtable_contains(const struct hashtable *self, const char *key){
 }
 
 void hashtable_rehash(struct hashtable *self){
-  size_t old_size = self->size;
-  size_t new_size = old_size * 2; //on augmente la taille de 2
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    cuckoo_rehash(self);
+    return;
+  }
+  chained_resize(self, self->size * 2); //on augmente la taille de 2
+}
 
-  struct bucket **new_buckets = calloc(new_size, sizeof(struct bucket *)); //on initialise le nouveau tableau de bucket à la nouvelle taille
+static void chained_resize(struct hashtable *self, size_t new_size){
+  struct hashtable resized = *self;
+  resized.size = new_size;
+  resized.pages = pages_create(new_size, self->policy, &resized.page_shift); //on initialise le nouveau tableau de bucket à la nouvelle taille
 
-  for(size_t i = 0; i < old_size; ++i){         //on va effectuer une boucle avec la taille de l'ancien tableau
-    struct bucket *current = self->buckets[i];  //on va recuperer le bucket de l'indice i
-    while(current != NULL){                     //tant que le bucket courant n'est pas NULL 
-      struct bucket *next = current->next;      //on récuperer le noeud suivant
-      char *key = current->key;                 //initialise la clé au bon indice
-      size_t key_hash = hash(key);                
-      size_t index = key_hash % new_size;       //recalculer le nouvel indice de hachage
+  for(size_t p = 0; p < chained_page_count(self); ++p){
+    struct bucket_page *page = self->pages[p];
+    bool shared = atomic_load_explicit(&page->refs, memory_order_acquire) != 1; //un instantané voit encore ces noeuds: on les recopie
+                                                                                  //directement à leur nouvelle place au lieu de les déplacer
+    for(size_t i = 0; i < chained_page_size(self); ++i){
+      struct bucket *current = page->heads[i];  //on va recuperer le bucket de l'indice i
+      while(current != NULL){                   //tant que le bucket courant n'est pas NULL
+        struct bucket *next = current->next;    //on récuperer le noeud suivant
+        size_t key_hash = hash_seeded(current->key, self->seed);
+        size_t index = key_hash % new_size;     //recalculer le nouvel indice de hachage
 
-      current->next = new_buckets[index];        
-      new_buckets[index] = current;             //on va mettre le noeud courant dans le nouveau tableau à l'indice calculer précédemment
+        struct bucket *node = current;
+        if(shared){
+          node = malloc(sizeof(struct bucket));
+          node->key = key_share(current->key);
+          node->value = value_copy(&current->value);
+        }
+        struct bucket **head = chained_head(&resized, index);
+        node->next = *head;
+        *head = node;                           //on va mettre le noeud dans le nouveau tableau à l'indice calculer précédemment
 
-      current = next;
+        current = next;
+      }
     }
+    page_release(page, chained_page_size(self), shared); //les noeuds non partagés ont été déplacés
   }
 
-  free(self->buckets);
-  self->buckets = new_buckets;
-  self->size = new_size;
+  free(self->pages);
+  *self = resized;
 }
 
 void hashtable_set_nil(struct hashtable *self, const char *key) {
@@ -287,9 +833,13 @@ void hashtable_set_custom(struct hashtable *self, const char *key, void *val) {
 }
 
 struct value hashtable_get(struct hashtable *self, const char *key){
-  size_t key_hash = hash(key);
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    struct value *slot = cuckoo_lookup(self, key);
+    return slot != NULL ? *slot : value_make_nil();
+  }
+  size_t key_hash = hash_seeded(key, self->seed);
   size_t index = key_hash % self->size;
-  struct bucket *current = self->buckets[index];
+  struct bucket *current = *chained_head(self, index);
   while(current != NULL){
     if(strcmp(current->key, key) == 0){
       return current->value;
@@ -298,3 +848,790 @@ struct value hashtable_get(struct hashtable *self, const char *key){
   }
   return value_make_nil();
 }
+
+
+
+/*
+ * snapshots
+ */
+
+struct hashtable_snapshot hashtable_snapshot(struct hashtable *self){
+  if(self->engine != HASHTABLE_ENGINE_CHAINED){  //les slots cuckoo sont modifiés sur place, rien à partager
+    struct hashtable_snapshot invalid = { NULL, 0, 0, 0, 0 };
+    return invalid;
+  }
+  size_t count = chained_page_count(self);
+  struct hashtable_snapshot res = { malloc(count * sizeof(struct bucket_page *)), self->page_shift, self->count, self->size, self->seed };
+
+  for(size_t i = 0; i < count; ++i){            //seules les pages sont partagées: aucun noeud n'est copié ici
+    res.pages[i] = self->pages[i];
+    atomic_fetch_add_explicit(&res.pages[i]->refs, 1, memory_order_relaxed);
+  }
+  return res;
+}
+
+bool hashtable_snapshot_is_valid(const struct hashtable_snapshot *self){
+  return self->pages != NULL;
+}
+
+void hashtable_snapshot_destroy(struct hashtable_snapshot *self){
+  pages_release(self->pages, self->size >> self->page_shift, (size_t)1 << self->page_shift);
+}
+
+size_t hashtable_snapshot_get_count(const struct hashtable_snapshot *self){
+  return self->count;
+}
+
+static const struct bucket *snapshot_find(const struct hashtable_snapshot *self, const char *key){
+  if(self->pages == NULL){
+    return NULL;
+  }
+  size_t index = hash_seeded(key, self->seed) % self->size;
+  const struct bucket_page *page = self->pages[index >> self->page_shift];
+  const struct bucket *current = page->heads[index & (((size_t)1 << self->page_shift) - 1)];
+  while(current != NULL){
+    if(strcmp(current->key, key) == 0){
+      return current;
+    }
+    current = current->next;
+  }
+  return NULL;
+}
+
+bool hashtable_snapshot_contains(const struct hashtable_snapshot *self, const char *key){
+  return snapshot_find(self, key) != NULL;
+}
+
+struct value hashtable_snapshot_get(const struct hashtable_snapshot *self, const char *key){
+  const struct bucket *found = snapshot_find(self, key);
+  return found != NULL ? found->value : value_make_nil();
+}
+
+
+
+/*
+ * bulk operations
+ */
+
+#define HASHTABLE_PARALLEL_THRESHOLD 65536
+#define HASHTABLE_MAX_THREADS 16
+
+struct partition {
+  size_t begin; // range of buckets handled by this partition
+  size_t end;
+  size_t delta;   // number of elements added or removed
+  size_t longest; // longest chain walked
+  const void *task;
+};
+
+// découpe [0, buckets) en plages disjointes traitées en parallèle si le volume le justifie
+static size_t partition_run(size_t buckets, size_t elements, void *(*work)(void *), const void *task, size_t *longest){
+  size_t threads = 1;
+  if(elements >= HASHTABLE_PARALLEL_THRESHOLD){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus < 1 ? 1 : (size_t)cpus;
+    if(threads > HASHTABLE_MAX_THREADS){
+      threads = HASHTABLE_MAX_THREADS;
+    }
+    if(threads > buckets){
+      threads = buckets;
+    }
+  }
+
+  struct partition parts[HASHTABLE_MAX_THREADS];
+  pthread_t ids[HASHTABLE_MAX_THREADS];
+  bool started[HASHTABLE_MAX_THREADS];
+
+  for(size_t t = 0; t < threads; ++t){
+    parts[t] = (struct partition){ buckets * t / threads, buckets * (t + 1) / threads, 0, 0, task };
+  }
+  for(size_t t = 1; t < threads; ++t){
+    started[t] = pthread_create(&ids[t], NULL, work, &parts[t]) == 0;
+  }
+  work(&parts[0]);
+
+  size_t delta = parts[0].delta;
+  *longest = parts[0].longest;
+  for(size_t t = 1; t < threads; ++t){
+    if(started[t]){
+      pthread_join(ids[t], NULL);
+    }else{                                      //si le thread n'a pas pu être créé on traite la plage ici
+      work(&parts[t]);
+    }
+    delta += parts[t].delta;
+    if(parts[t].longest > *longest){
+      *longest = parts[t].longest;
+    }
+  }
+  return delta;
+}
+
+static struct value merge_value(enum hashtable_merge_policy policy, hashtable_combine_fn combine, void *data, const char *key, struct value dst, struct value src){
+  switch(policy){
+    case HASHTABLE_MERGE_KEEP:
+      return dst;
+    case HASHTABLE_MERGE_OVERWRITE:
+      return src;
+    case HASHTABLE_MERGE_COMBINE:
+      break;
+  }
+  assert(combine != NULL);
+  return combine(key, dst, src, data);
+}
+
+static struct value *hashtable_lookup(const struct hashtable *self, const char *key){
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    return cuckoo_lookup(self, key);
+  }
+  struct bucket *current = *chained_head(self, hash_seeded(key, self->seed) % self->size);
+  while(current != NULL){
+    if(strcmp(current->key, key) == 0){
+      return &current->value;
+    }
+    current = current->next;
+  }
+  return NULL;
+}
+
+static void hashtable_foreach(const struct hashtable *self, void (*fn)(const char *key, struct value val, void *data), void *data){
+  if(self->engine == HASHTABLE_ENGINE_CUCKOO){
+    for(size_t i = 0; i < self->size / CUCKOO_BUCKET_SLOTS; ++i){
+      for(int j = 0; j < CUCKOO_BUCKET_SLOTS; ++j){
+        if(self->slots[i].keys[j] != NULL){
+          fn(self->slots[i].keys[j], self->slots[i].values[j], data);
+        }
+      }
+    }
+    for(size_t i = 0; i < self->stash_count; ++i){
+      fn(self->stash[i].key, self->stash[i].value, data);
+    }
+    return;
+  }
+  for(size_t i = 0; i < self->size; ++i){
+    for(struct bucket *current = *chained_head(self, i); current != NULL; current = current->next){
+      fn(current->key, current->value, data);
+    }
+  }
+}
+
+struct merge_task {
+  struct hashtable *dst;
+  struct hashtable *src;
+  enum hashtable_merge_policy policy;
+  hashtable_combine_fn combine;
+  void *data;
+};
+
+// la taille de dst est un multiple de celle de src et les deux tables ont la même graine, les
+// noeuds du bucket i de src vont donc dans des buckets j de dst tels que j % src->size == i:
+// les plages de src sont indépendantes
+static void *merge_work(void *arg){
+  struct partition *part = arg;
+  const struct merge_task *task = part->task;
+  struct hashtable *dst = task->dst;
+  struct hashtable *src = task->src;
+
+  for(size_t i = part->begin; i < part->end; ++i){
+    struct bucket **src_head = chained_head(src, i);
+    struct bucket *current = *src_head;
+    *src_head = NULL;
+    while(current != NULL){
+      struct bucket *next = current->next;
+      size_t index = hash_seeded(current->key, dst->seed) % dst->size;
+      struct bucket **head = chained_head(dst, index);
+      struct bucket *found = *head;
+      size_t length = 0;
+      while(found != NULL && strcmp(found->key, current->key) != 0){
+        found = found->next;
+        ++length;
+      }
+      if(length > part->longest){
+        part->longest = length;
+      }
+
+      if(found != NULL){                        //clé déjà présente: on applique la politique et on libère le noeud de src
+        struct value merged = merge_value(task->policy, task->combine, task->data, found->key, found->value, current->value);
+        value_release_unless(&found->value, &merged);
+        value_release_unless(&current->value, &merged);
+        found->value = merged;
+        key_release(current->key);
+        free(current);
+      }else{                                    //sinon on déplace le noeud sans copier la clé
+        current->next = *head;
+        *head = current;
+        ++part->delta;
+      }
+      current = next;
+    }
+  }
+  return NULL;
+}
+
+static void merge_one(const char *key, struct value val, void *data){
+  const struct merge_task *task = data;
+  struct value copy = value_copy(&val);         //src sera détruite avec ses valeurs
+  struct value *found = hashtable_lookup(task->dst, key);
+  if(found != NULL){
+    struct value merged = merge_value(task->policy, task->combine, task->data, key, *found, copy);
+    value_release_unless(found, &merged);
+    value_release_unless(&copy, &merged);
+    *found = merged;
+  }else{
+    hashtable_insert(task->dst, key, copy);
+  }
+}
+
+void hashtable_merge(struct hashtable *dst, struct hashtable *src, enum hashtable_merge_policy policy, hashtable_combine_fn combine, void *data){
+  assert(dst != src);
+  struct merge_task task = { dst, src, policy, combine, data };
+
+  if(dst->engine != HASHTABLE_ENGINE_CHAINED || src->engine != HASHTABLE_ENGINE_CHAINED){
+    if(dst->engine == HASHTABLE_ENGINE_CHAINED){
+      chained_unshare(dst);
+    }
+    hashtable_foreach(src, merge_one, &task);
+    hashtable_destroy(src);
+    hashtable_create_with_engine(src, src->engine, src->policy);
+    return;
+  }
+
+  size_t new_size = dst->size;                  //on dimensionne dst une seule fois pour le pire cas où toutes les clés sont nouvelles
+  while(new_size < src->size || (double)(dst->count + src->count) / new_size > 1.0 / 2){
+    new_size *= 2;
+  }
+  if(dst->seed == 0 && src->seed != 0){         //on ne revient jamais à la graine 0: src a subi une attaque, dst adopte sa graine
+    dst->seed = src->seed;
+    chained_resize(dst, new_size);
+  }else if(new_size != dst->size){
+    chained_resize(dst, new_size);
+  }
+  if(src->seed != dst->seed){                   //les deux tables doivent avoir la même graine pour que les plages soient indépendantes
+    src->seed = dst->seed;
+    chained_resize(src, src->size);
+  }
+  chained_unshare(dst);                         //les threads ne peuvent pas copier une page partagée par plusieurs plages
+  chained_unshare(src);
+
+  size_t longest = 0;
+  dst->count += partition_run(src->size, src->count, merge_work, &task, &longest);
+  src->count = 0;
+
+  if(longest >= HASHTABLE_CHAIN_LIMIT){
+    dst->seed = hash_new_seed(dst->seed);
+    chained_resize(dst, dst->size);
+  }
+}
+
+struct filter_task {
+  struct hashtable *self;
+  const struct hashtable *other;
+  bool keep_present; // keep the keys present in other (intersection) or absent from it (difference)
+};
+
+static void *filter_work(void *arg){
+  struct partition *part = arg;
+  const struct filter_task *task = part->task;
+  struct hashtable *self = task->self;
+
+  for(size_t i = part->begin; i < part->end; ++i){
+    struct bucket **link = chained_head(self, i);
+    while(*link != NULL){
+      struct bucket *current = *link;
+      if(hashtable_contains(task->other, current->key) != task->keep_present){
+        *link = current->next;
+        value_release(&current->value);
+        key_release(current->key);
+        free(current);
+        ++part->delta;
+      }else{
+        link = &current->next;
+      }
+    }
+  }
+  return NULL;
+}
+
+struct filter_keys {
+  const struct filter_task *task;
+  char **keys;
+  size_t count;
+};
+
+static void filter_collect(const char *key, struct value val, void *data){
+  (void)val;
+  struct filter_keys *collected = data;
+  if(hashtable_contains(collected->task->other, key) != collected->task->keep_present){
+    collected->keys[collected->count++] = (char *)key;
+  }
+}
+
+static void hashtable_filter(struct hashtable *self, const struct hashtable *other, bool keep_present){
+  assert(self != other);
+  struct filter_task task = { self, other, keep_present };
+
+  if(self->engine != HASHTABLE_ENGINE_CHAINED){ //on ne peut pas retirer pendant le parcours d'une table coucou: on collecte d'abord les clés
+    struct filter_keys collected = { &task, malloc((self->count + 1) * sizeof(char *)), 0 };
+    hashtable_foreach(self, filter_collect, &collected);
+    for(size_t i = 0; i < collected.count; ++i){
+      char *key = malloc((str_length(collected.keys[i]) + 1) * sizeof(char));
+      strcpy(key, collected.keys[i]);
+      hashtable_remove(self, key);
+      free(key);
+    }
+    free(collected.keys);
+    return;
+  }
+
+  chained_unshare(self);
+  size_t longest = 0;
+  self->count -= partition_run(self->size, self->count, filter_work, &task, &longest);
+}
+
+void hashtable_intersect(struct hashtable *self, const struct hashtable *other){
+  hashtable_filter(self, other, true);
+}
+
+void hashtable_difference(struct hashtable *self, const struct hashtable *other){
+  hashtable_filter(self, other, false);
+}
+
+
+
+/*
+ * hashtable with integer keys
+ */
+
+void hashtable_int_create(struct hashtable_int *self){
+  hashtable_int_create_with_policy(self, HASHTABLE_ALLOC_DEFAULT);
+}
+
+void hashtable_int_create_with_policy(struct hashtable_int *self, unsigned policy){
+  self->size = HASHTABLE_INITIAL_SIZE;
+  self->count = 0;
+  self->policy = policy;
+  self->seed = 0;
+  self->buckets = buckets_alloc(self->size, sizeof(struct int_bucket *), self->policy);
+}
+
+void hashtable_int_destroy(struct hashtable_int *self){
+  for(size_t i = 0; i < self->size; ++i){
+    struct int_bucket *current = self->buckets[i];
+    while(current != NULL){
+      struct int_bucket *next = current->next;
+      value_release(&current->value);
+      free(current);
+      current = next;
+    }
+  }
+  buckets_free(self->buckets, self->size, sizeof(struct int_bucket *), self->policy);
+}
+
+size_t hashtable_int_get_count(const struct hashtable_int *self) {
+  return self->count;
+}
+
+size_t hashtable_int_get_size(const struct hashtable_int *self) {
+  return self->size;
+}
+
+static size_t hash_int(int64_t key){
+  uint64_t x = (uint64_t)key;   //une seule multiplication entre deux xorshift pour mélanger tous les bits
+  x ^= x >> 32;
+  x *= 0xd6e8feb86659fd93u;
+  x ^= x >> 32;
+  return (size_t)x;
+}
+
+// hash_int s'inverse facilement: une fois la graine tirée, on passe à SipHash sur les 8 octets de la clé
+static size_t hash_int_seeded(int64_t key, uint64_t seed){
+  if(seed == 0){
+    return hash_int(key);
+  }
+  unsigned char bytes[sizeof(int64_t)];
+  for(size_t i = 0; i < sizeof(bytes); ++i){
+    bytes[i] = (unsigned char)((uint64_t)key >> (8 * i));
+  }
+  return (size_t)siphash13(bytes, sizeof(bytes), seed, seed ^ 0x9e3779b97f4a7c15u);
+}
+
+static void int_resize(struct hashtable_int *self, size_t new_size);
+
+bool hashtable_int_insert(struct hashtable_int *self, int64_t key, struct value val){
+  size_t index = hash_int_seeded(key, self->seed) & (self->size - 1); //la taille est une puissance de 2, un masque suffit
+  struct int_bucket *current = self->buckets[index];
+  size_t length = 0;
+  while(current != NULL){
+    if(current->key == key){
+      value_release_unless(&current->value, &val);
+      current->value = val;
+      return false;
+    }
+    current = current->next;
+    ++length;
+  }
+
+  current = malloc(sizeof(struct int_bucket));            //la clé est stockée directement dans le noeud, pas de copie
+  current->key = key;
+  current->value = val;
+  current->next = self->buckets[index];
+  self->buckets[index] = current;
+  ++self->count;
+
+  if(length >= HASHTABLE_CHAIN_LIMIT){                     //liste anormalement longue: on change de graine et on redistribue
+    self->seed = hash_new_seed(self->seed);
+    int_resize(self, self->size);
+  }
+
+  if((double)(self->count) / self->size > 1.0 / 2){
+    hashtable_int_rehash(self);
+  }
+
+  return true;
+}
+
+bool hashtable_int_remove(struct hashtable_int *self, int64_t key){
+  size_t index = hash_int_seeded(key, self->seed) & (self->size - 1);
+  struct int_bucket *current = self->buckets[index];
+  struct int_bucket *prev = NULL;
+  while(current != NULL){
+    if(current->key == key){
+      if(prev != NULL){
+        prev->next = current->next;
+      }else{
+        self->buckets[index] = current->next;
+      }
+      value_release(&current->value);
+      free(current);
+      --self->count;
+      return true;
+    }
+    prev = current;
+    current = current->next;
+  }
+  return false;
+}
+
+bool hashtable_int_contains(const struct hashtable_int *self, int64_t key){
+  size_t index = hash_int_seeded(key, self->seed) & (self->size - 1);
+  struct int_bucket *current = self->buckets[index];
+  while(current != NULL){
+    if(current->key == key){
+      return true;
+    }
+    current = current->next;
+  }
+  return false;
+}
+
+void hashtable_int_rehash(struct hashtable_int *self){
+  int_resize(self, self->size * 2);
+}
+
+static void int_resize(struct hashtable_int *self, size_t new_size){
+  size_t old_size = self->size;
+
+  struct int_bucket **new_buckets = buckets_alloc(new_size, sizeof(struct int_bucket *), self->policy);
+
+  for(size_t i = 0; i < old_size; ++i){
+    struct int_bucket *current = self->buckets[i];
+    while(current != NULL){
+      struct int_bucket *next = current->next;
+      size_t index = hash_int_seeded(current->key, self->seed) & (new_size - 1);
+
+      current->next = new_buckets[index];
+      new_buckets[index] = current;
+
+      current = next;
+    }
+  }
+
+  buckets_free(self->buckets, old_size, sizeof(struct int_bucket *), self->policy);
+  self->buckets = new_buckets;
+  self->size = new_size;
+}
+
+void hashtable_int_set_nil(struct hashtable_int *self, int64_t key) {
+  hashtable_int_insert(self, key, value_make_nil());
+}
+
+void hashtable_int_set_boolean(struct hashtable_int *self, int64_t key, bool val) {
+  hashtable_int_insert(self, key, value_make_boolean(val));
+}
+
+void hashtable_int_set_integer(struct hashtable_int *self, int64_t key, int64_t val) {
+  hashtable_int_insert(self, key, value_make_integer(val));
+}
+
+void hashtable_int_set_real(struct hashtable_int *self, int64_t key, double val) {
+  hashtable_int_insert(self, key, value_make_real(val));
+}
+
+void hashtable_int_set_custom(struct hashtable_int *self, int64_t key, void *val) {
+  hashtable_int_insert(self, key, value_make_custom(val));
+}
+
+struct value hashtable_int_get(const struct hashtable_int *self, int64_t key){
+  size_t index = hash_int_seeded(key, self->seed) & (self->size - 1);
+  struct int_bucket *current = self->buckets[index];
+  while(current != NULL){
+    if(current->key == key){
+      return current->value;
+    }
+    current = current->next;
+  }
+  return value_make_nil();
+}
+
+
+
+/*
+ * cuckoo engine
+ */
+
+#define CUCKOO_BFS_MAX 256
+
+struct cuckoo_node {
+  size_t bucket;
+  int parent; // index of the parent node in the queue, -1 for a root
+  int slot;   // slot of the parent bucket whose element moves into this bucket
+};
+
+static size_t cuckoo_mask(const struct hashtable *self){
+  return self->size / CUCKOO_BUCKET_SLOTS - 1;
+}
+
+static size_t cuckoo_index(size_t key_hash, size_t which, size_t mask){
+  static const uint64_t seeds[2] = { 0x0u, 0x9e3779b97f4a7c15u }; //deux fonctions de hachage dérivées du même hachage de la clé
+  return hash_int((int64_t)(key_hash ^ seeds[which])) & mask;
+}
+
+static size_t cuckoo_alternate(size_t key_hash, size_t bucket, size_t mask){
+  size_t first = cuckoo_index(key_hash, 0, mask);
+  return bucket == first ? cuckoo_index(key_hash, 1, mask) : first;
+}
+
+static int cuckoo_free_slot(const struct cuckoo_bucket *bucket){
+  for(int i = 0; i < CUCKOO_BUCKET_SLOTS; ++i){
+    if(bucket->keys[i] == NULL){
+      return i;
+    }
+  }
+  return -1;
+}
+
+static bool cuckoo_on_path(const struct cuckoo_node *queue, int node, size_t bucket){
+  for(; node >= 0; node = queue[node].parent){
+    if(queue[node].bucket == bucket){
+      return true;
+    }
+  }
+  return false;
+}
+
+static void cuckoo_create(struct hashtable *self){
+  assert(self->size % CUCKOO_BUCKET_SLOTS == 0);
+  self->slots = buckets_alloc(self->size / CUCKOO_BUCKET_SLOTS, sizeof(struct cuckoo_bucket), self->policy);
+}
+
+static void cuckoo_destroy(struct hashtable *self){
+  size_t count = self->size / CUCKOO_BUCKET_SLOTS;
+  for(size_t i = 0; i < count; ++i){
+    for(int j = 0; j < CUCKOO_BUCKET_SLOTS; ++j){
+      if(self->slots[i].keys[j] != NULL){
+        value_release(&self->slots[i].values[j]);
+        free(self->slots[i].keys[j]);
+      }
+    }
+  }
+  for(size_t i = 0; i < self->stash_count; ++i){
+    value_release(&self->stash[i].value);
+    free(self->stash[i].key);
+  }
+  buckets_free(self->slots, count, sizeof(struct cuckoo_bucket), self->policy);
+}
+
+// place un élément absent de la table, renvoie false sans rien modifier si aucune place n'a été trouvée
+static bool cuckoo_place(struct hashtable *self, char *key, size_t key_hash, struct value val){
+  size_t mask = cuckoo_mask(self);
+  struct cuckoo_node queue[CUCKOO_BFS_MAX];
+  int head = 0;
+  int tail = 0;
+
+  queue[tail++] = (struct cuckoo_node){ cuckoo_index(key_hash, 0, mask), -1, -1 };
+  queue[tail++] = (struct cuckoo_node){ cuckoo_index(key_hash, 1, mask), -1, -1 };
+
+  while(head < tail){                                         //parcours en largeur: on cherche le plus court chemin de déplacements
+    int node = head++;                                        //menant à un bucket qui a une case libre
+    struct cuckoo_bucket *bucket = &self->slots[queue[node].bucket];
+    int slot = cuckoo_free_slot(bucket);
+
+    if(slot >= 0){
+      while(queue[node].parent >= 0){                         //on remonte le chemin en déplaçant chaque élément dans la case libérée
+        int parent = queue[node].parent;
+        struct cuckoo_bucket *from = &self->slots[queue[parent].bucket];
+        int from_slot = queue[node].slot;
+
+        bucket->hashes[slot] = from->hashes[from_slot];
+        bucket->keys[slot] = from->keys[from_slot];
+        bucket->values[slot] = from->values[from_slot];
+
+        bucket = from;
+        slot = from_slot;
+        node = parent;
+      }
+      bucket->hashes[slot] = key_hash;
+      bucket->keys[slot] = key;
+      bucket->values[slot] = val;
+      return true;
+    }
+
+    for(int i = 0; i < CUCKOO_BUCKET_SLOTS && tail < CUCKOO_BFS_MAX; ++i){
+      size_t next = cuckoo_alternate(bucket->hashes[i], queue[node].bucket, mask);
+      if(!cuckoo_on_path(queue, node, next)){                 //un bucket n'apparait qu'une fois par chemin
+        queue[tail++] = (struct cuckoo_node){ next, node, i };
+      }
+    }
+  }
+
+  if(self->stash_count < CUCKOO_STASH_SIZE){
+    self->stash[self->stash_count++] = (struct cuckoo_entry){ key, key_hash, val };
+    return true;
+  }
+  return false;
+}
+
+static struct value *cuckoo_lookup(const struct hashtable *self, const char *key){
+  size_t key_hash = hash_seeded(key, self->seed);
+  size_t mask = cuckoo_mask(self);
+
+  for(size_t i = 0; i < 2; ++i){
+    struct cuckoo_bucket *bucket = &self->slots[cuckoo_index(key_hash, i, mask)];
+    for(int j = 0; j < CUCKOO_BUCKET_SLOTS; ++j){
+      if(bucket->hashes[j] == key_hash && bucket->keys[j] != NULL && strcmp(bucket->keys[j], key) == 0){
+        return &bucket->values[j];
+      }
+    }
+  }
+
+  for(size_t i = 0; i < self->stash_count; ++i){
+    if(self->stash[i].hash == key_hash && strcmp(self->stash[i].key, key) == 0){
+      return (struct value *)&self->stash[i].value;
+    }
+  }
+  return NULL;
+}
+
+static bool cuckoo_insert(struct hashtable *self, const char *key, struct value val){
+  struct value *slot = cuckoo_lookup(self, key);
+  if(slot != NULL){
+    value_release_unless(slot, &val);
+    *slot = val;
+    return false;
+  }
+
+  char *n_key = malloc((str_length(key) + 1) * sizeof(char));
+  strcpy(n_key, key);
+
+  while(!cuckoo_place(self, n_key, hash_seeded(key, self->seed), val)){
+    if(self->count >= self->size / 2 || !cuckoo_reseed(self)){ //échec dans une table peu remplie: collisions forcées, on change de graine
+      cuckoo_rehash(self);                                      //sinon on double la taille
+    }
+  }
+  ++self->count;
+  return true;
+}
+
+static bool cuckoo_remove(struct hashtable *self, const char *key){
+  size_t key_hash = hash_seeded(key, self->seed);
+  size_t mask = cuckoo_mask(self);
+  bool found = false;
+
+  for(size_t i = 0; i < 2 && !found; ++i){
+    struct cuckoo_bucket *bucket = &self->slots[cuckoo_index(key_hash, i, mask)];
+    for(int j = 0; j < CUCKOO_BUCKET_SLOTS; ++j){
+      if(bucket->hashes[j] == key_hash && bucket->keys[j] != NULL && strcmp(bucket->keys[j], key) == 0){
+        value_release(&bucket->values[j]);
+        free(bucket->keys[j]);
+        bucket->hashes[j] = 0;
+        bucket->keys[j] = NULL;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  for(size_t i = 0; i < self->stash_count && !found; ++i){
+    if(self->stash[i].hash == key_hash && strcmp(self->stash[i].key, key) == 0){
+      value_release(&self->stash[i].value);
+      free(self->stash[i].key);
+      self->stash[i] = self->stash[--self->stash_count];
+      found = true;
+    }
+  }
+
+  if(!found){
+    return false;
+  }
+  --self->count;
+
+  for(size_t i = self->stash_count; i-- > 0;){                 //une case s'est peut-être libérée pour un élément de la réserve
+    struct cuckoo_entry *entry = &self->stash[i];
+    for(size_t j = 0; j < 2; ++j){
+      struct cuckoo_bucket *bucket = &self->slots[cuckoo_index(entry->hash, j, mask)];
+      int slot = cuckoo_free_slot(bucket);
+      if(slot >= 0){
+        bucket->hashes[slot] = entry->hash;
+        bucket->keys[slot] = entry->key;
+        bucket->values[slot] = entry->value;
+        *entry = self->stash[--self->stash_count];
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+// replace tous les éléments dans un nouveau tableau, renvoie false en laissant la table intacte en cas d'échec
+static bool cuckoo_rebuild(struct hashtable *self, size_t new_size, uint64_t seed){
+  size_t old_count = self->size / CUCKOO_BUCKET_SLOTS;
+  struct hashtable next = *self;
+  next.size = new_size;
+  next.seed = seed;
+  next.stash_count = 0;
+  cuckoo_create(&next);
+
+  bool placed = true;
+  for(size_t i = 0; i < old_count && placed; ++i){
+    struct cuckoo_bucket *bucket = &self->slots[i];
+    for(int j = 0; j < CUCKOO_BUCKET_SLOTS && placed; ++j){
+      if(bucket->keys[j] != NULL){
+        size_t key_hash = seed == self->seed ? bucket->hashes[j] : hash_seeded(bucket->keys[j], seed);
+        placed = cuckoo_place(&next, bucket->keys[j], key_hash, bucket->values[j]);
+      }
+    }
+  }
+  for(size_t i = 0; i < self->stash_count && placed; ++i){
+    size_t key_hash = seed == self->seed ? self->stash[i].hash : hash_seeded(self->stash[i].key, seed);
+    placed = cuckoo_place(&next, self->stash[i].key, key_hash, self->stash[i].value);
+  }
+
+  if(!placed){
+    buckets_free(next.slots, next.size / CUCKOO_BUCKET_SLOTS, sizeof(struct cuckoo_bucket), next.policy); //les clés appartiennent toujours à l'ancien tableau
+    return false;
+  }
+
+  buckets_free(self->slots, old_count, sizeof(struct cuckoo_bucket), self->policy);
+  *self = next;
+  return true;
+}
+
+static void cuckoo_rehash(struct hashtable *self){
+  size_t new_size = self->size * 2;
+  while(!cuckoo_rebuild(self, new_size, self->seed)){
+    new_size *= 2;
+  }
+}
+
+static bool cuckoo_reseed(struct hashtable *self){
+  return cuckoo_rebuild(self, self->size, hash_new_seed(self->seed));
+}
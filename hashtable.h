@@ -17,6 +17,22 @@ enum value_kind {
   VALUE_CUSTOM,
 };
 
+// HASHTABLE_COMPACT_VALUE changes the layout of every structure below, it must be
+// defined the same way for the library and all of its users
+#ifdef HASHTABLE_COMPACT_VALUE
+
+// NaN-boxed value: a real keeps its bits (NaNs are canonicalized), other kinds
+// are tagged negative quiet NaNs carrying a 48-bit payload. The stored word is
+// xor-ed so that all-zero bits still read as nil. Integers that do not fit in
+// 48 bits are boxed on the heap. Custom and box pointers must have their top 16
+// bits clear, which excludes tagged heaps (ARM64 top-byte tags, MTE) and 57-bit
+// addresses under 5-level paging: such a pointer aborts instead of being truncated.
+struct value {
+  uint64_t bits;
+};
+
+#else
+
 struct value {
   enum value_kind kind;
   union {
@@ -27,6 +43,8 @@ struct value {
   } as;
 };
 
+#endif
+
 enum value_kind value_get_kind(const struct value *self);
 
 bool value_is_nil(const struct value *self);
@@ -52,6 +70,12 @@ struct value value_make_integer(int64_t val);
 struct value value_make_real(double val);
 struct value value_make_custom(void *val);
 
+// a value may own storage (boxed integers in the compact representation): tables
+// take ownership of inserted values, hashtable_get returns a value still owned by
+// the table, and value_copy must be used to store it elsewhere
+void value_release(struct value *self);
+struct value value_copy(const struct value *self);
+
 
 
 struct bucket {
@@ -62,13 +86,64 @@ struct bucket {
 
 #define HASHTABLE_INITIAL_SIZE 4
 
+// bucket arrays at least this large are subject to the allocation policy
+#define HASHTABLE_LARGE_ALLOC (2 * 1024 * 1024)
+
+enum hashtable_alloc_policy {
+  HASHTABLE_ALLOC_DEFAULT    = 0,
+  HASHTABLE_ALLOC_HUGEPAGES  = 1 << 0, // map large bucket arrays with 2 MB pages
+  HASHTABLE_ALLOC_INTERLEAVE = 1 << 1, // interleave large bucket arrays across NUMA nodes
+};
+
+enum hashtable_engine {
+  HASHTABLE_ENGINE_CHAINED, // separate chaining, grows at load factor 0.5
+  HASHTABLE_ENGINE_CUCKOO,  // bucketized cuckoo hashing, at most two buckets and the stash per lookup
+};
+
+#define CUCKOO_BUCKET_SLOTS 4
+#define CUCKOO_STASH_SIZE 4
+
+// bucket arrays whose element size is a multiple of this are allocated aligned on it
+#define HASHTABLE_CACHE_LINE 64
+
+// cache-line aligned so that probing a bucket never touches more lines than its size requires
+struct cuckoo_bucket {
+  size_t hashes[CUCKOO_BUCKET_SLOTS];
+  char *keys[CUCKOO_BUCKET_SLOTS]; // NULL for an empty slot
+  struct value values[CUCKOO_BUCKET_SLOTS];
+} __attribute__((aligned(HASHTABLE_CACHE_LINE)));
+
+struct cuckoo_entry {
+  char *key;
+  size_t hash;
+  struct value value;
+};
+
+// buckets of the chained engine are grouped in pages of up to 2^HASHTABLE_PAGE_SHIFT
+// buckets, shared with snapshots and copied on the first write after a snapshot
+#define HASHTABLE_PAGE_SHIFT 9
+
+// an insertion walking a chain at least this long re-seeds the hash and redistributes the table
+#define HASHTABLE_CHAIN_LIMIT 16
+
+struct bucket_page;
+
 struct hashtable {
-  struct bucket **buckets;
-  size_t count; // number of elements in the table
-  size_t size;  // size of the buckets array
+  struct bucket_page **pages;
+  size_t page_shift; // log2 of the number of buckets per page
+  size_t count;    // number of elements in the table
+  size_t size;     // number of buckets, or number of slots for the cuckoo engine
+  unsigned policy; // combination of enum hashtable_alloc_policy flags
+  uint64_t seed;   // 0 for the default hash, keyed SipHash once a collision flood was detected
+  enum hashtable_engine engine;
+  struct cuckoo_bucket *slots; // size / CUCKOO_BUCKET_SLOTS buckets for the cuckoo engine
+  struct cuckoo_entry stash[CUCKOO_STASH_SIZE];
+  size_t stash_count;
 };
 
 void hashtable_create(struct hashtable *self);
+void hashtable_create_with_policy(struct hashtable *self, unsigned policy);
+void hashtable_create_with_engine(struct hashtable *self, enum hashtable_engine engine, unsigned policy);
 
 void hashtable_destroy(struct hashtable *self);
 
@@ -88,6 +163,86 @@ void hashtable_set_custom(struct hashtable *self, const char *key, void *val);
 
 struct value hashtable_get(struct hashtable *self, const char *key);
 
+// immutable point-in-time view of a chained table. Taking a snapshot reads the
+// table, so hashtable_snapshot() must run on the writer thread or with the writer
+// excluded; the snapshot itself is then readable from any thread without
+// synchronization while the table keeps being modified
+struct hashtable_snapshot {
+  struct bucket_page **pages;
+  size_t page_shift;
+  size_t count;
+  size_t size;
+  uint64_t seed;
+};
+
+// the cuckoo engine does not support snapshots: the result is then invalid and reads as empty
+struct hashtable_snapshot hashtable_snapshot(struct hashtable *self);
+bool hashtable_snapshot_is_valid(const struct hashtable_snapshot *self);
+
+void hashtable_snapshot_destroy(struct hashtable_snapshot *self);
+
+size_t hashtable_snapshot_get_count(const struct hashtable_snapshot *self);
+
+bool hashtable_snapshot_contains(const struct hashtable_snapshot *self, const char *key);
+struct value hashtable_snapshot_get(const struct hashtable_snapshot *self, const char *key);
+
+enum hashtable_merge_policy {
+  HASHTABLE_MERGE_KEEP,      // keep the value already in the destination
+  HASHTABLE_MERGE_OVERWRITE, // take the value from the source
+  HASHTABLE_MERGE_COMBINE,   // store the result of the combine callback
+};
+
+// may be called concurrently from several threads on large inputs
+typedef struct value (*hashtable_combine_fn)(const char *key, struct value dst, struct value src, void *data);
+
+// moves every element of src into dst, src is left empty
+void hashtable_merge(struct hashtable *dst, struct hashtable *src, enum hashtable_merge_policy policy, hashtable_combine_fn combine, void *data);
+// removes from self the keys absent from other
+void hashtable_intersect(struct hashtable *self, const struct hashtable *other);
+// removes from self the keys present in other
+void hashtable_difference(struct hashtable *self, const struct hashtable *other);
+
+
+
+/*
+ * hashtable with integer keys
+ */
+
+struct int_bucket {
+  int64_t key;
+  struct value value;
+  struct int_bucket *next;
+};
+
+struct hashtable_int {
+  struct int_bucket **buckets;
+  size_t count; // number of elements in the table
+  size_t size;     // size of the buckets array (always a power of 2)
+  unsigned policy; // combination of enum hashtable_alloc_policy flags
+  uint64_t seed;   // 0 for the default hash, keyed SipHash once a collision flood was detected
+};
+
+void hashtable_int_create(struct hashtable_int *self);
+void hashtable_int_create_with_policy(struct hashtable_int *self, unsigned policy);
+
+void hashtable_int_destroy(struct hashtable_int *self);
+
+size_t hashtable_int_get_count(const struct hashtable_int *self);
+size_t hashtable_int_get_size(const struct hashtable_int *self);
+
+bool hashtable_int_insert(struct hashtable_int *self, int64_t key, struct value val);
+bool hashtable_int_remove(struct hashtable_int *self, int64_t key);
+bool hashtable_int_contains(const struct hashtable_int *self, int64_t key);
+void hashtable_int_rehash(struct hashtable_int *self);
+
+void hashtable_int_set_nil(struct hashtable_int *self, int64_t key);
+void hashtable_int_set_boolean(struct hashtable_int *self, int64_t key, bool val);
+void hashtable_int_set_integer(struct hashtable_int *self, int64_t key, int64_t val);
+void hashtable_int_set_real(struct hashtable_int *self, int64_t key, double val);
+void hashtable_int_set_custom(struct hashtable_int *self, int64_t key, void *val);
+
+struct value hashtable_int_get(const struct hashtable_int *self, int64_t key);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,8 +1,13 @@
 #include "hashtable.h"
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <string>
+#include <thread>
 
 #include "gtest/gtest.h"
 
@@ -11,6 +16,29 @@ namespace {
   struct Dummy {
   };
 
+  // hash() forgets everything but the last 64 characters of a key
+  std::string colliding_key(int i) {
+    return std::to_string(i) + std::string(64, 'x');
+  }
+
+  // inverts hash_int(): every key gets a hash whose low 32 bits are zero
+  int64_t colliding_int_key(int i) {
+    const uint64_t mul = 0xd6e8feb86659fd93u;
+    uint64_t inv = mul;
+    for (int step = 0; step < 5; ++step) {
+      inv *= 2 - mul * inv;
+    }
+    uint64_t x = static_cast<uint64_t>(i + 1) << 32;
+    x ^= x >> 32;
+    x *= inv;
+    x ^= x >> 32;
+    return static_cast<int64_t>(x);
+  }
+
+  struct value combine_sum(const char *, struct value dst, struct value src, void *) {
+    return value_make_integer(value_get_integer(&dst) + value_get_integer(&src));
+  }
+
 }
 
 TEST(ValueTest, MakeNil) {
@@ -20,6 +48,20 @@ TEST(ValueTest, MakeNil) {
   EXPECT_EQ(value_get_kind(&val), VALUE_NIL);
 }
 
+TEST(ValueTest, ZeroedIsNil) {
+  struct value val;
+  std::memset(&val, 0, sizeof(val));
+
+  EXPECT_TRUE(value_is_nil(&val));
+  EXPECT_EQ(value_get_kind(&val), VALUE_NIL);
+
+  struct value *vals = static_cast<struct value *>(std::calloc(4, sizeof(struct value)));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(value_is_nil(&vals[i]));
+  }
+  std::free(vals);
+}
+
 TEST(ValueTest, MakeBoolean) {
   struct value val1 = value_make_boolean(true);
 
@@ -48,6 +90,26 @@ TEST(ValueTest, MakeInteger) {
   EXPECT_EQ(value_get_integer(&val2), -69);
 }
 
+TEST(ValueTest, MakeIntegerLimits) {
+  const int64_t values[] = { INT64_MIN, INT64_MIN + 1, -(INT64_C(1) << 47) - 1, -(INT64_C(1) << 47), (INT64_C(1) << 47) - 1, INT64_C(1) << 47, INT64_MAX };
+
+  for (int64_t v : values) {
+    struct value val = value_make_integer(v);
+
+    EXPECT_TRUE(value_is_integer(&val));
+    EXPECT_EQ(value_get_integer(&val), v);
+
+    struct value copy = value_copy(&val);
+    value_release(&val);
+
+    EXPECT_TRUE(value_is_nil(&val));
+    ASSERT_TRUE(value_is_integer(&copy));
+    EXPECT_EQ(value_get_integer(&copy), v);
+
+    value_release(&copy);
+  }
+}
+
 TEST(ValueTest, MakeReal) {
   struct value val1 = value_make_real(42.0);
 
@@ -60,6 +122,16 @@ TEST(ValueTest, MakeReal) {
   EXPECT_TRUE(value_is_real(&val2));
   EXPECT_EQ(value_get_kind(&val2), VALUE_REAL);
   EXPECT_EQ(value_get_real(&val2), -69.0);
+
+  struct value val3 = value_make_real(-NAN);
+
+  EXPECT_TRUE(value_is_real(&val3));
+  EXPECT_TRUE(std::isnan(value_get_real(&val3)));
+
+  struct value val4 = value_make_real(-INFINITY);
+
+  EXPECT_TRUE(value_is_real(&val4));
+  EXPECT_EQ(value_get_real(&val4), -INFINITY);
 }
 
 TEST(ValueTest, MakeCustom) {
@@ -80,6 +152,14 @@ TEST(ValueTest, MakeCustom) {
   EXPECT_EQ(value_get_custom(&val2), &dummy);
 }
 
+#ifdef HASHTABLE_COMPACT_VALUE
+TEST(ValueDeathTest, WidePointer) {
+  void *tagged = reinterpret_cast<void *>((static_cast<uintptr_t>(0x2a) << 56) | 0x1000);
+
+  EXPECT_DEATH(value_make_custom(tagged), "does not fit");
+}
+#endif
+
 TEST(ValueTest, Set) {
   struct value val = value_make_nil();
 
@@ -366,6 +446,30 @@ TEST(HashtableTest, SetGet) {
   hashtable_destroy(&h);
 }
 
+TEST(HashtableTest, LargeIntegers) {
+  struct hashtable h;
+  hashtable_create(&h);
+
+  hashtable_set_integer(&h, "foo", INT64_MAX);
+  hashtable_set_integer(&h, "foo", INT64_MIN);
+  hashtable_set_integer(&h, "bar", INT64_MAX);
+
+  struct value val = hashtable_get(&h, "foo");
+
+  ASSERT_TRUE(value_is_integer(&val));
+  EXPECT_EQ(value_get_integer(&val), INT64_MIN);
+
+  hashtable_insert(&h, "foo", val);
+  val = hashtable_get(&h, "foo");
+
+  ASSERT_TRUE(value_is_integer(&val));
+  EXPECT_EQ(value_get_integer(&val), INT64_MIN);
+
+  EXPECT_TRUE(hashtable_remove(&h, "bar"));
+
+  hashtable_destroy(&h);
+}
+
 TEST(HashtableTest, GetNotPresent) {
   struct hashtable h;
   hashtable_create(&h);
@@ -410,6 +514,560 @@ TEST(HashtableTest, Stress) {
   hashtable_destroy(&h);
 }
 
+TEST(HashtableTest, CollisionFlood) {
+  const enum hashtable_engine engines[] = { HASHTABLE_ENGINE_CHAINED, HASHTABLE_ENGINE_CUCKOO };
+
+  for (enum hashtable_engine engine : engines) {
+    struct hashtable h;
+    hashtable_create_with_engine(&h, engine, HASHTABLE_ALLOC_DEFAULT);
+
+    EXPECT_EQ(h.seed, 0u);
+
+    for (int i = 0; i < 2000; ++i) {
+      ASSERT_TRUE(hashtable_insert(&h, colliding_key(i).c_str(), value_make_integer(i)));
+    }
+
+    EXPECT_NE(h.seed, 0u);
+    EXPECT_EQ(hashtable_get_count(&h), 2000u);
+
+    for (int i = 0; i < 2000; ++i) {
+      struct value val = hashtable_get(&h, colliding_key(i).c_str());
+      ASSERT_TRUE(value_is_integer(&val));
+      ASSERT_EQ(value_get_integer(&val), i);
+    }
+
+    for (int i = 0; i < 2000; i += 2) {
+      ASSERT_TRUE(hashtable_remove(&h, colliding_key(i).c_str()));
+    }
+
+    EXPECT_EQ(hashtable_get_count(&h), 1000u);
+    EXPECT_FALSE(hashtable_contains(&h, colliding_key(0).c_str()));
+    EXPECT_TRUE(hashtable_contains(&h, colliding_key(1).c_str()));
+
+    hashtable_destroy(&h);
+  }
+}
+
+TEST(HashtableTest, OrdinaryKeysKeepSeed) {
+  const char *formats[] = { "%d", "key-%d", "%08x", "user:%d:profile" };
+
+  for (const char *format : formats) {
+    struct hashtable h;
+    hashtable_create(&h);
+
+    char key[32];
+    for (int i = 0; i < 400000; ++i) {
+      std::snprintf(key, sizeof(key), format, i);
+      hashtable_set_integer(&h, key, i);
+    }
+
+    EXPECT_EQ(h.seed, 0u) << format;
+    EXPECT_EQ(hashtable_get_count(&h), 400000u);
+
+    hashtable_destroy(&h);
+  }
+}
+
+TEST(HashtableSnapshotTest, PointInTime) {
+  struct hashtable h;
+  hashtable_create(&h);
+
+  for (int i = 0; i < 1000; ++i) {
+    hashtable_set_integer(&h, std::to_string(i).c_str(), i);
+  }
+
+  struct hashtable_snapshot snap = hashtable_snapshot(&h);
+  EXPECT_TRUE(hashtable_snapshot_is_valid(&snap));
+
+  hashtable_set_integer(&h, "0", -1);
+  EXPECT_TRUE(hashtable_remove(&h, "1"));
+  for (int i = 1000; i < 5000; ++i) {
+    hashtable_set_integer(&h, std::to_string(i).c_str(), i);
+  }
+
+  EXPECT_EQ(hashtable_get_count(&h), 4999u);
+  EXPECT_EQ(hashtable_snapshot_get_count(&snap), 1000u);
+
+  struct value val = hashtable_get(&h, "0");
+  ASSERT_TRUE(value_is_integer(&val));
+  EXPECT_EQ(value_get_integer(&val), -1);
+  EXPECT_FALSE(hashtable_contains(&h, "1"));
+
+  hashtable_destroy(&h);
+
+  for (int i = 0; i < 1000; ++i) {
+    val = hashtable_snapshot_get(&snap, std::to_string(i).c_str());
+    ASSERT_TRUE(value_is_integer(&val));
+    EXPECT_EQ(value_get_integer(&val), i);
+  }
+  EXPECT_FALSE(hashtable_snapshot_contains(&snap, "1000"));
+
+  hashtable_snapshot_destroy(&snap);
+}
+
+TEST(HashtableSnapshotTest, Cuckoo) {
+  struct hashtable h;
+  hashtable_create_with_engine(&h, HASHTABLE_ENGINE_CUCKOO, HASHTABLE_ALLOC_DEFAULT);
+
+  hashtable_set_integer(&h, "foo", 42);
+
+  struct hashtable_snapshot snap = hashtable_snapshot(&h);
+
+  EXPECT_FALSE(hashtable_snapshot_is_valid(&snap));
+  EXPECT_EQ(hashtable_snapshot_get_count(&snap), 0u);
+  EXPECT_FALSE(hashtable_snapshot_contains(&snap, "foo"));
+
+  struct value val = hashtable_snapshot_get(&snap, "foo");
+  EXPECT_TRUE(value_is_nil(&val));
+
+  hashtable_snapshot_destroy(&snap);
+  hashtable_destroy(&h);
+}
+
+TEST(HashtableSnapshotTest, Reseed) {
+  struct hashtable h;
+  hashtable_create(&h);
+
+  for (int i = 0; i < 10; ++i) {
+    hashtable_set_integer(&h, colliding_key(i).c_str(), i);
+  }
+
+  struct hashtable_snapshot snap = hashtable_snapshot(&h);
+
+  for (int i = 10; i < 100; ++i) {
+    hashtable_set_integer(&h, colliding_key(i).c_str(), i);
+  }
+
+  EXPECT_NE(h.seed, snap.seed);
+
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(hashtable_contains(&h, colliding_key(i).c_str()));
+    EXPECT_EQ(hashtable_snapshot_contains(&snap, colliding_key(i).c_str()), i < 10);
+  }
+
+  hashtable_snapshot_destroy(&snap);
+  hashtable_destroy(&h);
+}
+
+TEST(HashtableSnapshotTest, ConcurrentReader) {
+  struct hashtable h;
+  hashtable_create(&h);
+
+  for (int i = 0; i < 10000; ++i) {
+    hashtable_set_integer(&h, std::to_string(i).c_str(), i);
+  }
+
+  struct hashtable_snapshot snap = hashtable_snapshot(&h);
+
+  std::thread reader([&snap]() {
+    for (int round = 0; round < 10; ++round) {
+      for (int i = 0; i < 10000; ++i) {
+        struct value val = hashtable_snapshot_get(&snap, std::to_string(i).c_str());
+        ASSERT_TRUE(value_is_integer(&val));
+        ASSERT_EQ(value_get_integer(&val), i);
+      }
+    }
+  });
+
+  for (int i = 0; i < 10000; ++i) {
+    hashtable_set_integer(&h, std::to_string(i).c_str(), -i);
+    hashtable_set_integer(&h, std::to_string(i + 10000).c_str(), i);
+    hashtable_remove(&h, std::to_string(i / 2).c_str());
+  }
+
+  reader.join();
+
+  hashtable_snapshot_destroy(&snap);
+  hashtable_destroy(&h);
+}
+
+TEST(HashtableMergeTest, Policies) {
+  const enum hashtable_merge_policy policies[] = { HASHTABLE_MERGE_KEEP, HASHTABLE_MERGE_OVERWRITE, HASHTABLE_MERGE_COMBINE };
+  const int64_t expected[] = { 1, 10, 11 };
+
+  for (int i = 0; i < 3; ++i) {
+    struct hashtable dst;
+    hashtable_create(&dst);
+    struct hashtable src;
+    hashtable_create(&src);
+
+    hashtable_set_integer(&dst, "foo", 1);
+    hashtable_set_integer(&dst, "bar", 2);
+    hashtable_set_integer(&src, "foo", 10);
+    hashtable_set_integer(&src, "baz", 30);
+
+    hashtable_merge(&dst, &src, policies[i], combine_sum, nullptr);
+
+    EXPECT_EQ(hashtable_get_count(&dst), 3u);
+    EXPECT_EQ(hashtable_get_count(&src), 0u);
+    EXPECT_FALSE(hashtable_contains(&src, "foo"));
+
+    struct value val = hashtable_get(&dst, "foo");
+    ASSERT_TRUE(value_is_integer(&val));
+    EXPECT_EQ(value_get_integer(&val), expected[i]);
+
+    val = hashtable_get(&dst, "baz");
+    ASSERT_TRUE(value_is_integer(&val));
+    EXPECT_EQ(value_get_integer(&val), 30);
+
+    hashtable_destroy(&src);
+    hashtable_destroy(&dst);
+  }
+}
+
+TEST(HashtableMergeTest, MergeLarge) {
+  struct hashtable dst;
+  hashtable_create(&dst);
+  struct hashtable src;
+  hashtable_create_with_engine(&src, HASHTABLE_ENGINE_CHAINED, HASHTABLE_ALLOC_DEFAULT);
+
+  const std::size_t count = 200000;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    hashtable_set_integer(i % 2 == 0 ? &dst : &src, std::to_string(i).c_str(), 1);
+    hashtable_set_integer(&src, std::to_string(i + count).c_str(), 1);
+  }
+
+  hashtable_merge(&dst, &src, HASHTABLE_MERGE_COMBINE, combine_sum, nullptr);
+
+  EXPECT_EQ(hashtable_get_count(&dst), 2 * count);
+  EXPECT_EQ(hashtable_get_count(&src), 0u);
+
+  for (std::size_t i = 0; i < 2 * count; ++i) {
+    ASSERT_TRUE(hashtable_contains(&dst, std::to_string(i).c_str()));
+  }
+
+  hashtable_destroy(&src);
+  hashtable_destroy(&dst);
+}
+
+TEST(HashtableMergeTest, MergeSeeds) {
+  const std::size_t count = 100000;
+
+  for (int seeded = 0; seeded < 2; ++seeded) {
+    struct hashtable dst;
+    hashtable_create(&dst);
+    struct hashtable src;
+    hashtable_create(&src);
+
+    struct hashtable *flooded = seeded == 0 ? &dst : &src;
+    for (int i = 0; i < 100; ++i) {
+      hashtable_set_integer(flooded, colliding_key(i).c_str(), i);
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      hashtable_set_integer(i % 2 == 0 ? &dst : &src, std::to_string(i).c_str(), 1);
+      hashtable_set_integer(&src, std::to_string(i + count).c_str(), 1);
+    }
+    ASSERT_NE(dst.seed, src.seed);
+
+    hashtable_merge(&dst, &src, HASHTABLE_MERGE_COMBINE, combine_sum, nullptr);
+
+    EXPECT_EQ(hashtable_get_count(&dst), 2 * count + 100);
+    EXPECT_EQ(hashtable_get_count(&src), 0u);
+
+    for (std::size_t i = 0; i < 2 * count; ++i) {
+      struct value val = hashtable_get(&dst, std::to_string(i).c_str());
+      ASSERT_TRUE(value_is_integer(&val));
+      ASSERT_EQ(value_get_integer(&val), 1);
+    }
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(hashtable_contains(&dst, colliding_key(i).c_str()));
+    }
+
+    hashtable_destroy(&src);
+    hashtable_destroy(&dst);
+  }
+}
+
+TEST(HashtableMergeTest, MergeFloodedSource) {
+  const int count = 20000;
+
+  struct hashtable dst;
+  hashtable_create(&dst);
+  struct hashtable src;
+  hashtable_create(&src);
+
+  hashtable_set_integer(&dst, "foo", 42);
+  for (int i = 0; i < count; ++i) {
+    hashtable_set_integer(&src, colliding_key(i).c_str(), i);
+  }
+  uint64_t seed = src.seed;
+  ASSERT_NE(seed, 0u);
+
+  auto start = std::chrono::steady_clock::now();
+  hashtable_merge(&dst, &src, HASHTABLE_MERGE_OVERWRITE, nullptr, nullptr);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // dst adopts the seed of src: going back to the default hash would rebuild the
+  // flood chain and walk it for every node, then re-seed dst once more
+  EXPECT_EQ(dst.seed, seed);
+  EXPECT_LT(elapsed, std::chrono::seconds(1));
+  EXPECT_EQ(hashtable_get_count(&dst), static_cast<size_t>(count + 1));
+
+  for (int i = 0; i < count; ++i) {
+    struct value val = hashtable_get(&dst, colliding_key(i).c_str());
+    ASSERT_TRUE(value_is_integer(&val));
+    ASSERT_EQ(value_get_integer(&val), i);
+  }
+
+  hashtable_destroy(&src);
+  hashtable_destroy(&dst);
+}
+
+TEST(HashtableMergeTest, IntersectDifference) {
+  const enum hashtable_engine engines[] = { HASHTABLE_ENGINE_CHAINED, HASHTABLE_ENGINE_CUCKOO };
+
+  for (enum hashtable_engine engine : engines) {
+    struct hashtable a;
+    hashtable_create_with_engine(&a, engine, HASHTABLE_ALLOC_DEFAULT);
+    struct hashtable b;
+    hashtable_create_with_engine(&b, engine, HASHTABLE_ALLOC_DEFAULT);
+    struct hashtable other;
+    hashtable_create(&other);
+
+    for (int i = 0; i < 100; ++i) {
+      hashtable_set_integer(&a, std::to_string(i).c_str(), i);
+      hashtable_set_integer(&b, std::to_string(i).c_str(), i);
+    }
+    for (int i = 0; i < 100; i += 3) {
+      hashtable_set_nil(&other, std::to_string(i).c_str());
+    }
+
+    hashtable_intersect(&a, &other);
+    hashtable_difference(&b, &other);
+
+    EXPECT_EQ(hashtable_get_count(&a), 34u);
+    EXPECT_EQ(hashtable_get_count(&b), 66u);
+
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_EQ(hashtable_contains(&a, std::to_string(i).c_str()), i % 3 == 0);
+      EXPECT_EQ(hashtable_contains(&b, std::to_string(i).c_str()), i % 3 != 0);
+    }
+
+    hashtable_merge(&a, &b, HASHTABLE_MERGE_KEEP, nullptr, nullptr);
+
+    EXPECT_EQ(hashtable_get_count(&a), 100u);
+    EXPECT_EQ(hashtable_get_count(&b), 0u);
+
+    hashtable_destroy(&other);
+    hashtable_destroy(&b);
+    hashtable_destroy(&a);
+  }
+}
+
+TEST(HashtableCuckooTest, InsertSame) {
+  struct hashtable h;
+  hashtable_create_with_engine(&h, HASHTABLE_ENGINE_CUCKOO, HASHTABLE_ALLOC_DEFAULT);
+
+  EXPECT_EQ(hashtable_get_count(&h), 0u);
+  EXPECT_EQ(hashtable_get_size(&h), static_cast<size_t>(HASHTABLE_INITIAL_SIZE));
+
+  char s1[] = "foo";
+
+  EXPECT_TRUE(hashtable_insert(&h, s1, value_make_integer(42)));
+  EXPECT_FALSE(hashtable_insert(&h, "foo", value_make_real(3.14)));
+
+  s1[0] = '\0';
+
+  EXPECT_EQ(hashtable_get_count(&h), 1u);
+  EXPECT_TRUE(hashtable_contains(&h, "foo"));
+  EXPECT_FALSE(hashtable_contains(&h, "bar"));
+
+  struct value val = hashtable_get(&h, "foo");
+
+  ASSERT_TRUE(value_is_real(&val));
+  EXPECT_EQ(value_get_real(&val), 3.14);
+
+  EXPECT_TRUE(hashtable_remove(&h, "foo"));
+  EXPECT_FALSE(hashtable_remove(&h, "foo"));
+  EXPECT_EQ(hashtable_get_count(&h), 0u);
+
+  val = hashtable_get(&h, "foo");
+
+  EXPECT_TRUE(value_is_nil(&val));
+
+  hashtable_destroy(&h);
+}
+
+TEST(HashtableCuckooTest, Stress) {
+  struct hashtable h;
+  hashtable_create_with_engine(&h, HASHTABLE_ENGINE_CUCKOO, HASHTABLE_ALLOC_DEFAULT);
+
+  std::string key = "abcdefgh";
+  std::size_t count = 0;
+
+  do {
+    ASSERT_TRUE(hashtable_insert(&h, key.c_str(), value_make_integer(count)));
+    ++count;
+  } while(std::next_permutation(key.begin(), key.end()));
+
+  EXPECT_EQ(hashtable_get_count(&h), count);
+  EXPECT_LE(hashtable_get_size(&h), static_cast<size_t>(16384 * HASHTABLE_INITIAL_SIZE));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(h.slots) % HASHTABLE_CACHE_LINE, 0u);
+
+  count = 0;
+
+  do {
+    struct value val = hashtable_get(&h, key.c_str());
+    ASSERT_TRUE(value_is_integer(&val));
+    ASSERT_EQ(value_get_integer(&val), static_cast<int64_t>(count));
+    ++count;
+  } while(std::next_permutation(key.begin(), key.end()));
+
+  std::sort(key.begin(), key.end(), std::greater<char>());
+
+  do {
+    ASSERT_TRUE(hashtable_remove(&h, key.c_str()));
+  } while(std::prev_permutation(key.begin(), key.end()));
+
+  EXPECT_EQ(hashtable_get_count(&h), 0u);
+
+  hashtable_destroy(&h);
+}
+
+TEST(HashtableIntTest, CreateEmpty) {
+  struct hashtable_int h;
+  hashtable_int_create(&h);
+
+  EXPECT_EQ(hashtable_int_get_count(&h), 0u);
+  EXPECT_EQ(hashtable_int_get_size(&h), static_cast<size_t>(HASHTABLE_INITIAL_SIZE));
+
+  hashtable_int_destroy(&h);
+}
+
+TEST(HashtableIntTest, InsertSame) {
+  struct hashtable_int h;
+  hashtable_int_create(&h);
+
+  EXPECT_TRUE(hashtable_int_insert(&h, 42, value_make_integer(42)));
+  EXPECT_FALSE(hashtable_int_insert(&h, 42, value_make_real(3.14)));
+
+  EXPECT_EQ(hashtable_int_get_count(&h), 1u);
+  EXPECT_TRUE(hashtable_int_contains(&h, 42));
+  EXPECT_FALSE(hashtable_int_contains(&h, -42));
+
+  struct value val = hashtable_int_get(&h, 42);
+
+  ASSERT_TRUE(value_is_real(&val));
+  EXPECT_EQ(value_get_real(&val), 3.14);
+
+  hashtable_int_destroy(&h);
+}
+
+TEST(HashtableIntTest, SetGet) {
+  struct hashtable_int h;
+  hashtable_int_create(&h);
+
+  hashtable_int_set_boolean(&h, INT64_MIN, true);
+  hashtable_int_set_integer(&h, 0, 42);
+  hashtable_int_set_real(&h, INT64_MAX, 69.0);
+
+  EXPECT_EQ(hashtable_int_get_count(&h), 3u);
+
+  struct value val = hashtable_int_get(&h, INT64_MIN);
+  ASSERT_TRUE(value_is_boolean(&val));
+  EXPECT_EQ(value_get_boolean(&val), true);
+
+  val = hashtable_int_get(&h, 0);
+  ASSERT_TRUE(value_is_integer(&val));
+  EXPECT_EQ(value_get_integer(&val), 42);
+
+  val = hashtable_int_get(&h, INT64_MAX);
+  ASSERT_TRUE(value_is_real(&val));
+  EXPECT_EQ(value_get_real(&val), 69.0);
+
+  val = hashtable_int_get(&h, 1);
+  EXPECT_TRUE(value_is_nil(&val));
+
+  hashtable_int_destroy(&h);
+}
+
+TEST(HashtableIntTest, Stress) {
+  struct hashtable_int h;
+  hashtable_int_create(&h);
+
+  const int64_t count = 100000;
+
+  for (int64_t i = 0; i < count; ++i) {
+    ASSERT_TRUE(hashtable_int_insert(&h, i * 4096, value_make_integer(i)));
+  }
+
+  EXPECT_EQ(hashtable_int_get_count(&h), static_cast<size_t>(count));
+  EXPECT_EQ(hashtable_int_get_size(&h), static_cast<size_t>(65536 * HASHTABLE_INITIAL_SIZE));
+
+  for (int64_t i = 0; i < count; ++i) {
+    struct value val = hashtable_int_get(&h, i * 4096);
+    ASSERT_TRUE(value_is_integer(&val));
+    ASSERT_EQ(value_get_integer(&val), i);
+  }
+
+  for (int64_t i = 0; i < count; ++i) {
+    ASSERT_TRUE(hashtable_int_remove(&h, i * 4096));
+  }
+
+  EXPECT_EQ(hashtable_int_get_count(&h), 0u);
+
+  hashtable_int_destroy(&h);
+}
+
+TEST(HashtableIntTest, CollisionFlood) {
+  struct hashtable_int h;
+  hashtable_int_create(&h);
+
+  for (int64_t i = 0; i < 100000; ++i) {
+    hashtable_int_set_integer(&h, i, i);
+  }
+  EXPECT_EQ(h.seed, 0u);
+
+  const int count = 20000;
+
+  for (int i = 0; i < count; ++i) {
+    ASSERT_TRUE(hashtable_int_insert(&h, colliding_int_key(i), value_make_integer(i)));
+  }
+
+  EXPECT_NE(h.seed, 0u);
+  EXPECT_EQ(hashtable_int_get_count(&h), static_cast<size_t>(100000 + count));
+
+  for (int i = 0; i < count; ++i) {
+    struct value val = hashtable_int_get(&h, colliding_int_key(i));
+    ASSERT_TRUE(value_is_integer(&val));
+    ASSERT_EQ(value_get_integer(&val), i);
+  }
+  for (int64_t i = 0; i < 100000; ++i) {
+    ASSERT_TRUE(hashtable_int_contains(&h, i));
+  }
+
+  for (int i = 0; i < count; i += 2) {
+    ASSERT_TRUE(hashtable_int_remove(&h, colliding_int_key(i)));
+  }
+  EXPECT_FALSE(hashtable_int_contains(&h, colliding_int_key(0)));
+  EXPECT_TRUE(hashtable_int_contains(&h, colliding_int_key(1)));
+
+  hashtable_int_destroy(&h);
+}
+
+TEST(HashtableTest, AllocPolicy) {
+  struct hashtable h;
+  hashtable_create_with_policy(&h, HASHTABLE_ALLOC_HUGEPAGES | HASHTABLE_ALLOC_INTERLEAVE);
+
+  const std::size_t count = 300000;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    ASSERT_TRUE(hashtable_insert(&h, std::to_string(i).c_str(), value_make_integer(i)));
+  }
+
+  EXPECT_EQ(hashtable_get_count(&h), count);
+  ASSERT_GE(hashtable_get_size(&h) * sizeof(struct bucket *), static_cast<size_t>(HASHTABLE_LARGE_ALLOC));
+
+  for (std::size_t i = 0; i < count; ++i) {
+    struct value val = hashtable_get(&h, std::to_string(i).c_str());
+    ASSERT_TRUE(value_is_integer(&val));
+    ASSERT_EQ(value_get_integer(&val), static_cast<int64_t>(i));
+  }
+
+  hashtable_destroy(&h);
+}
+
 /*
  * main
  */